@@ -0,0 +1,270 @@
+#include "AlignmentMetrics.hpp"
+
+#include <pbbam/FastaReader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "SequenceCompare.hpp"
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+
+constexpr std::array<int8_t, 256> BASE_INDEX = []() {
+    std::array<int8_t, 256> index{};
+    index.fill(-1);
+    // soft-masked bases count like their upper-case form, as in CountMatches
+    for (size_t i = 0; i < BASES.size(); ++i) {
+        index[static_cast<uint8_t>(BASES[i])] = static_cast<int8_t>(i);
+        index[static_cast<uint8_t>(BASES[i] | 0x20)] = static_cast<int8_t>(i);
+    }
+    return index;
+}();
+
+int32_t BaseIndex(const char base) { return BASE_INDEX[static_cast<uint8_t>(base)]; }
+
+void Count(BaseCounts& counts, const char refBase)
+{
+    const int32_t r = BaseIndex(refBase);
+    if (r >= 0) {
+        ++counts[r];
+    }
+}
+
+void Count(BasePairCounts& counts, const char refBase, const char qryBase)
+{
+    const int32_t r = BaseIndex(refBase);
+    const int32_t q = BaseIndex(qryBase);
+    if (r >= 0 && q >= 0) {
+        ++counts[r][q];
+    }
+}
+}  // namespace
+
+References ReadReferences(const std::string& refFile)
+{
+    References refs;
+    BAM::FastaReader fastaReader{refFile};
+    BAM::FastaSequence fasta;
+    while (fastaReader.GetNext(fasta)) {
+        refs.insert({fasta.Name(), fasta.Bases()});
+    }
+    return refs;
+}
+
+AlignmentMetrics ComputeMetrics(const Data::Cigar& cigar, const std::string_view qry,
+                                const std::string_view ref, const ColumnSet& columns)
+{
+    AlignmentMetrics m;
+
+    // Per-base counters need both sequences; each group is only filled if
+    // its columns are requested.
+    const bool hasSeqs = !ref.empty() && !qry.empty();
+    const bool sub = hasSeqs && columns.Has(Column::SUB);
+    const bool insSingle = hasSeqs && columns.Has(Column::INS_SINGLE);
+    const bool delSingle = hasSeqs && columns.Has(Column::DEL_SINGLE);
+    const bool delAll = hasSeqs && columns.Has(Column::DEL_ALL);
+
+    // Validate the spans once, so that the loop below can index both
+    // sequences without further checks
+    size_t qrySpan = 0;
+    size_t refSpan = 0;
+    bool hasAlignmentMatch = false;
+    for (const auto& op : cigar) {
+        switch (op.Type()) {
+            case Data::CigarOperationType::INSERTION:
+            case Data::CigarOperationType::SOFT_CLIP:
+                qrySpan += op.Length();
+                break;
+            case Data::CigarOperationType::DELETION:
+                refSpan += op.Length();
+                break;
+            case Data::CigarOperationType::ALIGNMENT_MATCH:
+                hasAlignmentMatch = true;
+                [[fallthrough]];
+            case Data::CigarOperationType::SEQUENCE_MATCH:
+            case Data::CigarOperationType::SEQUENCE_MISMATCH:
+                qrySpan += op.Length();
+                refSpan += op.Length();
+                break;
+            default:
+                break;
+        }
+    }
+    if (hasAlignmentMatch && !hasSeqs) {
+        throw std::runtime_error{
+            "ALIGNMENT MATCH operations require query and reference sequences"};
+    }
+    if (hasSeqs && (qrySpan > qry.size() || refSpan > ref.size())) {
+        throw std::runtime_error{"CIGAR spans " + std::to_string(qrySpan) + " query and " +
+                                 std::to_string(refSpan) + " reference bases, but sequences have " +
+                                 std::to_string(qry.size()) + " and " + std::to_string(ref.size())};
+    }
+
+    size_t qryPos = 0;
+    size_t refPos = 0;
+    for (const auto& op : cigar) {
+        const int32_t len = op.Length();
+        switch (op.Type()) {
+            case Data::CigarOperationType::INSERTION:
+                // an insertion after the last aligned base has no reference base
+                if (insSingle && refPos < ref.size()) {
+                    Count(m.InsSingle, ref[refPos], qry[qryPos]);
+                }
+                ++m.InsEvents;
+                if (len > 1) {
+                    ++m.InsMultiEvents;
+                }
+                m.Ins += len;
+                qryPos += len;
+                break;
+            case Data::CigarOperationType::DELETION:
+                if (delSingle) {
+                    Count(m.DelSingle, ref[refPos]);
+                }
+                if (delAll) {
+                    for (int32_t i = 0; i < len; ++i) {
+                        Count(m.DelAll, ref[refPos + i]);
+                    }
+                }
+                ++m.DelEvents;
+                if (len > 1) {
+                    ++m.DelMultiEvents;
+                }
+                m.Del += len;
+                refPos += len;
+                break;
+            case Data::CigarOperationType::SEQUENCE_MISMATCH:
+                if (sub) {
+                    for (int32_t i = 0; i < len; ++i) {
+                        Count(m.Sub, ref[refPos + i], qry[qryPos + i]);
+                    }
+                }
+                m.Mismatch += len;
+                refPos += len;
+                qryPos += len;
+                break;
+            case Data::CigarOperationType::SEQUENCE_MATCH:
+                if (sub) {
+                    for (int32_t i = 0; i < len; ++i) {
+                        Count(m.Sub, ref[refPos + i], qry[qryPos + i]);
+                    }
+                }
+                refPos += len;
+                qryPos += len;
+                m.Match += len;
+                break;
+            case Data::CigarOperationType::ALIGNMENT_MATCH: {
+                // Split M into =/X by comparing the sequences directly
+                const int32_t matches = CountMatches(qry.data() + qryPos, ref.data() + refPos, len);
+                if (sub) {
+                    for (int32_t i = 0; i < len; ++i) {
+                        Count(m.Sub, ref[refPos + i], qry[qryPos + i]);
+                    }
+                }
+                m.Match += matches;
+                m.Mismatch += len - matches;
+                refPos += len;
+                qryPos += len;
+                break;
+            }
+            case Data::CigarOperationType::SOFT_CLIP:
+                qryPos += len;
+                break;
+            case Data::CigarOperationType::HARD_CLIP:
+                m.HardClip += len;
+                break;
+            case Data::CigarOperationType::REFERENCE_SKIP:
+                throw std::runtime_error{"UNSUPPORTED OPERATION: REFERENCE SKIP"};
+            case Data::CigarOperationType::PADDING:
+                throw std::runtime_error{"UNSUPPORTED OPERATION: PADDING"};
+            case Data::CigarOperationType::UNKNOWN_OP:
+            default:
+                throw std::runtime_error{"UNKNOWN OP"};
+        }
+    }
+
+    // The aligned query span equals the number of aligned query bases
+    const int32_t nErr = m.Ins + m.Del + m.Mismatch;
+    m.SeqLen = static_cast<int32_t>(qryPos);
+    m.AlnLen = m.Match + m.Ins + m.Mismatch;
+    // unmapped records and deletion-only alignments have nothing to measure
+    if (m.AlnLen == 0) {
+        return m;
+    }
+    m.Concordance = 1.0 - 1.0 * nErr / m.AlnLen;
+    m.Qv = m.Concordance == 1 ? 60 : (-10 * std::log10(1 - m.Concordance));
+    return m;
+}
+
+AlignmentMetrics ComputeMetrics(const BAM::BamRecord& record, const References& refs,
+                                const ColumnSet& columns)
+{
+    return ComputeMetrics(
+        record, [&refs]() -> const References& { return refs; }, columns);
+}
+
+AlignmentMetrics ComputeMetrics(const BAM::BamRecord& record, const ReferenceSource& refs,
+                                const ColumnSet& columns)
+{
+    const Data::Cigar cigar = record.CigarData();
+    const bool hasAlignmentMatch =
+        std::any_of(cigar.cbegin(), cigar.cend(), [](const Data::CigarOperation& op) {
+            return op.Type() == Data::CigarOperationType::ALIGNMENT_MATCH;
+        });
+
+    // Secondary alignments of minimap2 and BWA store no sequence (SEQ *),
+    // their M operations cannot be split into matches and mismatches
+    if (hasAlignmentMatch && record.Impl().SequenceLength() == 0) {
+        AlignmentMetrics unresolved;
+        unresolved.Resolved = false;
+        return unresolved;
+    }
+
+    std::string_view ref;
+    std::string qry;
+    if (columns.HasExtended() || hasAlignmentMatch) {
+        const References& references = refs();
+        const auto it = references.find(record.ReferenceName());
+        if (it != references.cend()) {
+            const auto start = static_cast<size_t>(record.ReferenceStart());
+            const auto end = static_cast<size_t>(record.ReferenceEnd());
+            if (start > end || end > it->second.size()) {
+                throw std::runtime_error{"Alignment " + record.FullName() + " spans [" +
+                                         std::to_string(start) + ", " + std::to_string(end) +
+                                         ") beyond the end of reference " + record.ReferenceName()};
+            }
+            ref = std::string_view{it->second}.substr(start, end - start);
+            qry = record.Sequence(Data::Orientation::GENOMIC);
+        } else if (hasAlignmentMatch) {
+            throw std::runtime_error{"ALIGNMENT MATCH operations require the reference sequence " +
+                                     record.ReferenceName()};
+        }
+    }
+
+    AlignmentMetrics m = ComputeMetrics(cigar, qry, ref, columns);
+
+    // Tag lookups and name building happen only for requested columns
+    if (columns.Has(Column::NAME)) {
+        m.Name = record.FullName();
+    }
+    // the stored sequence, also for unmapped records without a CIGAR
+    if (columns.Has(Column::SEQLEN)) {
+        m.SeqLen = static_cast<int32_t>(record.Impl().SequenceLength());
+    }
+    if (columns.Has(Column::PASSES) && record.HasNumPasses()) {
+        m.NumPasses = record.NumPasses();
+    }
+    if (columns.Has(Column::EC) && record.Impl().HasTag("ec")) {
+        m.Ec = static_cast<int32_t>(record.Impl().TagValue("ec").ToFloat());
+    }
+    if (columns.Has(Column::RQ) && record.HasReadAccuracy()) {
+        m.Rq = static_cast<float>(record.ReadAccuracy());
+    }
+    return m;
+}
+}  // namespace Harmony
+}  // namespace PacBio
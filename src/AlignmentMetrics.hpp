@@ -0,0 +1,109 @@
+#pragma once
+
+#include <pbbam/BamRecord.h>
+#include <pbcopper/data/Cigar.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Columns.hpp"
+
+namespace PacBio {
+namespace Harmony {
+
+/// Reference name to bases
+using References = std::unordered_map<std::string, std::string>;
+
+///
+/// \returns all sequences of a FASTA file, keyed by name
+///
+References ReadReferences(const std::string& refFile);
+
+/// Supplies the references on demand, only called for records that need
+/// reference bases
+using ReferenceSource = std::function<const References&()>;
+
+/// Counts per reference base, indexed by position in BASES
+using BaseCounts = std::array<int32_t, BASES.size()>;
+/// Counts per reference base and query base, indexed by position in BASES
+using BasePairCounts = std::array<BaseCounts, BASES.size()>;
+
+///
+/// Per-alignment metrics. Fields whose column was not requested keep their
+/// default value.
+///
+struct AlignmentMetrics
+{
+    std::string Name;
+    int32_t NumPasses = -1;
+    int32_t Ec = -1;
+    float Rq = -1.f;
+    int32_t SeqLen = 0;
+
+    int32_t AlnLen = 0;
+    double Concordance = 0;
+    int32_t Qv = 0;
+    int32_t Match = 0;
+    int32_t Mismatch = 0;
+    int32_t Del = 0;
+    int32_t Ins = 0;
+    int32_t DelEvents = 0;
+    int32_t InsEvents = 0;
+    int32_t DelMultiEvents = 0;
+    int32_t InsMultiEvents = 0;
+    int32_t HardClip = 0;
+    /// false if M operations could not be split into matches and mismatches
+    /// because the record stores no sequence; all other fields are unset
+    bool Resolved = true;
+
+    BasePairCounts Sub{};
+    BasePairCounts InsSingle{};
+    BaseCounts DelSingle{};
+    BasePairCounts InsAll{};
+    BaseCounts DelAll{};
+};
+
+///
+/// Computes metrics from a raw alignment. SeqLen is the query span of the
+/// cigar; concordance and qv stay 0 for alignments without aligned bases.
+///
+/// \param cigar    alignment in genomic orientation, using =/X or M operations
+/// \param qry      query bases in genomic orientation, only required for
+///                 extended columns or if cigar contains M operations
+/// \param ref      reference bases covered by the alignment, only required
+///                 for extended columns or if cigar contains M operations
+/// \param columns  metrics to compute
+///
+/// \throws std::runtime_error on unsupported CIGAR operations, M operations
+///         without sequences, or a CIGAR spanning more bases than given
+///
+AlignmentMetrics ComputeMetrics(const Data::Cigar& cigar, std::string_view qry,
+                                std::string_view ref, const ColumnSet& columns = ColumnSet::All());
+
+///
+/// Computes metrics from an aligned BAM record. Record-level fields (name,
+/// passes, ec, rq, seqlen) are only decoded if their column is requested.
+/// Sequences are only extracted for extended columns or M operations.
+/// Records with M operations but without a stored sequence are returned
+/// with Resolved set to false.
+///
+/// \throws std::runtime_error on unsupported CIGAR operations, M operations
+///         on a reference missing from refs, or an alignment extending past
+///         the end of its reference
+///
+AlignmentMetrics ComputeMetrics(const BAM::BamRecord& record, const References& refs,
+                                const ColumnSet& columns = ColumnSet::All());
+
+///
+/// Same as above, but the references are only requested from refs if the
+/// record contains M operations or extended columns are requested. This allows
+/// callers to defer loading the reference until it is first needed.
+///
+AlignmentMetrics ComputeMetrics(const BAM::BamRecord& record, const ReferenceSource& refs,
+                                const ColumnSet& columns = ColumnSet::All());
+}  // namespace Harmony
+}  // namespace PacBio
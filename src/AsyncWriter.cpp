@@ -0,0 +1,510 @@
+#include "AsyncWriter.hpp"
+
+#include <pbcopper/logging/Logging.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifdef HARMONY_HAS_LIBURING
+#include <liburing.h>
+#endif
+
+namespace PacBio {
+namespace Harmony {
+
+class AsyncWriter::Backend
+{
+public:
+    virtual ~Backend() = default;
+
+    /// Starts writing data[0, len) at offset. The buffer must stay untouched
+    /// until Wait(idx) returns.
+    virtual void Submit(size_t idx, const char* data, size_t len, int64_t offset) = 0;
+
+    /// Blocks until the write of buffer idx has completed
+    virtual void Wait(size_t idx) = 0;
+};
+
+namespace {
+constexpr size_t ALIGNMENT = 4096;
+
+[[noreturn]] void WriteFailed(const int errnum)
+{
+    PBLOG_FATAL << "Could not write output: " << std::strerror(errnum);
+    std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+}
+
+// Blocking backend, one background thread issues the writes in submission
+// order. Used for pipes and whenever io_uring is unavailable.
+class ThreadBackend : public AsyncWriter::Backend
+{
+public:
+    ThreadBackend(const int fd, const bool seekable, const size_t numBuffers)
+        : fd_{fd}, seekable_{seekable}, pending_(numBuffers, false), thread_{[this]() { Run(); }}
+    {}
+
+    ~ThreadBackend() override
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void Submit(const size_t idx, const char* data, const size_t len, const int64_t offset) override
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            pending_[idx] = true;
+            jobs_.push_back({idx, data, len, offset});
+        }
+        cv_.notify_all();
+    }
+
+    void Wait(const size_t idx) override
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        cv_.wait(lock, [&]() { return !pending_[idx] || error_ != 0; });
+        if (error_ != 0) {
+            WriteFailed(error_);
+        }
+    }
+
+private:
+    struct Job
+    {
+        size_t Idx;
+        const char* Data;
+        size_t Len;
+        int64_t Offset;
+    };
+
+    void Run()
+    {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                cv_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+                if (jobs_.empty()) {
+                    return;
+                }
+                job = jobs_.front();
+                jobs_.pop_front();
+            }
+
+            int errnum = 0;
+            while (job.Len > 0) {
+                const ssize_t n = seekable_ ? pwrite(fd_, job.Data, job.Len, job.Offset)
+                                            : write(fd_, job.Data, job.Len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    errnum = errno;
+                    break;
+                }
+                job.Data += n;
+                job.Len -= n;
+                job.Offset += n;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                pending_[job.Idx] = false;
+                if (errnum != 0) {
+                    error_ = errnum;
+                }
+            }
+            cv_.notify_all();
+        }
+    }
+
+    const int fd_;
+    const bool seekable_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    std::vector<bool> pending_;
+    int error_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#ifdef HARMONY_HAS_LIBURING
+// io_uring backend, all buffers may be in flight at distinct file offsets.
+// Completions are reaped on the calling thread, short writes are resubmitted.
+class UringBackend : public AsyncWriter::Backend
+{
+public:
+    static std::unique_ptr<UringBackend> Create(const int fd, const size_t numBuffers)
+    {
+        std::unique_ptr<UringBackend> backend{new UringBackend{fd, numBuffers}};
+        if (io_uring_queue_init(numBuffers, &backend->ring_, 0) < 0) {
+            return nullptr;
+        }
+        backend->initialized_ = true;
+
+        // IORING_OP_WRITE arrived in Linux 5.6, together with the probe
+        // interface; kernels without either fall back to the thread backend
+        io_uring_probe* probe = io_uring_get_probe_ring(&backend->ring_);
+        const bool hasWrite =
+            probe != nullptr && io_uring_opcode_supported(probe, IORING_OP_WRITE) != 0;
+        if (probe != nullptr) {
+            io_uring_free_probe(probe);
+        }
+        if (!hasWrite) {
+            return nullptr;
+        }
+        return backend;
+    }
+
+    ~UringBackend() override
+    {
+        if (initialized_) {
+            for (size_t i = 0; i < jobs_.size(); ++i) {
+                Wait(i);
+            }
+            io_uring_queue_exit(&ring_);
+        }
+    }
+
+    void Submit(const size_t idx, const char* data, const size_t len, const int64_t offset) override
+    {
+        jobs_[idx] = {data, len, offset, true};
+        Enqueue(idx);
+    }
+
+    void Wait(const size_t idx) override
+    {
+        while (jobs_[idx].Pending) {
+            io_uring_cqe* cqe = nullptr;
+            const int ret = io_uring_wait_cqe(&ring_, &cqe);
+            if (ret == -EINTR) {
+                continue;
+            }
+            if (ret < 0) {
+                WriteFailed(-ret);
+            }
+            const auto done = reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe));
+            const int res = cqe->res;
+            io_uring_cqe_seen(&ring_, cqe);
+            if (res <= 0) {
+                WriteFailed(res == 0 ? EIO : -res);
+            }
+
+            Job& job = jobs_[done];
+            job.Data += res;
+            job.Len -= res;
+            job.Offset += res;
+            if (job.Len > 0) {
+                Enqueue(done);
+            } else {
+                job.Pending = false;
+            }
+        }
+    }
+
+private:
+    struct Job
+    {
+        const char* Data = nullptr;
+        size_t Len = 0;
+        int64_t Offset = 0;
+        bool Pending = false;
+    };
+
+    UringBackend(const int fd, const size_t numBuffers) : fd_{fd}, jobs_(numBuffers) {}
+
+    void Enqueue(const size_t idx)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (sqe == nullptr) {
+            WriteFailed(EBUSY);
+        }
+        const Job& job = jobs_[idx];
+        io_uring_prep_write(sqe, fd_, job.Data, job.Len, job.Offset);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(idx)));
+        const int ret = io_uring_submit(&ring_);
+        if (ret < 0) {
+            WriteFailed(-ret);
+        }
+    }
+
+    const int fd_;
+    io_uring ring_{};
+    bool initialized_ = false;
+    std::vector<Job> jobs_;
+};
+#endif
+}  // namespace
+
+void AsyncWriter::FreeDeleter::operator()(char* p) const { std::free(p); }
+
+AsyncWriter::AsyncWriter(const std::string& filename, const size_t bufferSize,
+                         const int32_t numBuffers)
+    : bufferSize_{(std::max(bufferSize, ALIGNMENT) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT}
+{
+    if (filename == "-") {
+        fd_ = STDOUT_FILENO;
+    } else {
+        fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            PBLOG_FATAL << "Could not open output file " << filename << " : "
+                        << std::strerror(errno);
+            std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+        }
+        ownsFd_ = true;
+    }
+
+    const size_t count = std::max(2, numBuffers);
+    for (size_t i = 0; i < count; ++i) {
+        auto* buffer = static_cast<char*>(std::aligned_alloc(ALIGNMENT, bufferSize_));
+        if (buffer == nullptr) {
+            throw std::bad_alloc{};
+        }
+        buffers_.emplace_back(buffer);
+    }
+
+    // Positional writes only for files we opened ourselves; stdout may be a
+    // pipe or a file opened for appending by the shell.
+    struct stat st;
+    const bool seekable = ownsFd_ && fstat(fd_, &st) == 0 && S_ISREG(st.st_mode);
+#ifdef HARMONY_HAS_LIBURING
+    if (seekable) {
+        backend_ = UringBackend::Create(fd_, count);
+    }
+#endif
+    if (!backend_) {
+        backend_ = std::make_unique<ThreadBackend>(fd_, seekable, count);
+    }
+}
+
+AsyncWriter::~AsyncWriter() { Close(); }
+
+void AsyncWriter::Write(std::string_view data)
+{
+    while (!data.empty()) {
+        const size_t n = std::min(data.size(), bufferSize_ - fill_);
+        std::memcpy(buffers_[current_].get() + fill_, data.data(), n);
+        fill_ += n;
+        data.remove_prefix(n);
+        if (fill_ == bufferSize_) {
+            SubmitCurrent();
+        }
+    }
+}
+
+void AsyncWriter::SubmitCurrent()
+{
+    if (fill_ == 0) {
+        return;
+    }
+    backend_->Submit(current_, buffers_[current_].get(), fill_, offset_);
+    offset_ += fill_;
+    fill_ = 0;
+
+    // the next buffer may still be in flight from the previous round
+    current_ = (current_ + 1) % buffers_.size();
+    backend_->Wait(current_);
+}
+
+void AsyncWriter::Close()
+{
+    if (fd_ < 0) {
+        return;
+    }
+    SubmitCurrent();
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        backend_->Wait(i);
+    }
+    backend_.reset();
+    if (ownsFd_ && close(fd_) != 0) {
+        WriteFailed(errno);
+    }
+    fd_ = -1;
+}
+
+// Writes full buffers in submission order, which keeps every file in order,
+// and recycles them into the spare pool.
+class MultiFileWriter::Worker
+{
+public:
+    Worker(const size_t bufferSize, const int32_t numSpareBuffers) : thread_{[this]() { Run(); }}
+    {
+        for (int32_t i = 0; i < std::max(1, numSpareBuffers); ++i) {
+            spares_.emplace_back(new char[bufferSize]);
+        }
+    }
+
+    ~Worker()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    /// Queues buffer[0, len) for fd, \returns a spare buffer in exchange
+    std::unique_ptr<char[]> Submit(const int fd, std::unique_ptr<char[]> buffer, const size_t len)
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        jobs_.push_back({fd, std::move(buffer), len});
+        cv_.notify_all();
+        cv_.wait(lock, [&]() { return !spares_.empty() || error_ != 0; });
+        if (error_ != 0) {
+            WriteFailed(error_);
+        }
+        std::unique_ptr<char[]> spare = std::move(spares_.back());
+        spares_.pop_back();
+        return spare;
+    }
+
+    /// Blocks until all queued buffers are written
+    void Drain()
+    {
+        std::unique_lock<std::mutex> lock{mutex_};
+        cv_.wait(lock, [&]() { return (jobs_.empty() && !busy_) || error_ != 0; });
+        if (error_ != 0) {
+            WriteFailed(error_);
+        }
+    }
+
+private:
+    struct Job
+    {
+        int Fd;
+        std::unique_ptr<char[]> Buffer;
+        size_t Len;
+    };
+
+    void Run()
+    {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                cv_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+                if (jobs_.empty()) {
+                    return;
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+                busy_ = true;
+            }
+
+            int errnum = 0;
+            const char* data = job.Buffer.get();
+            size_t len = job.Len;
+            while (len > 0) {
+                const ssize_t n = write(job.Fd, data, len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    errnum = errno;
+                    break;
+                }
+                data += n;
+                len -= n;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                spares_.push_back(std::move(job.Buffer));
+                busy_ = false;
+                if (errnum != 0) {
+                    error_ = errnum;
+                }
+            }
+            cv_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    std::vector<std::unique_ptr<char[]>> spares_;
+    bool busy_ = false;
+    int error_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+MultiFileWriter::MultiFileWriter(const size_t bufferSize, const int32_t numSpareBuffers)
+    : bufferSize_{std::max<size_t>(bufferSize, 1)}
+    , worker_{std::make_unique<Worker>(bufferSize_, numSpareBuffers)}
+{}
+
+MultiFileWriter::~MultiFileWriter() { Close(); }
+
+int32_t MultiFileWriter::Open(const std::string& filename)
+{
+    File file;
+    file.Fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file.Fd < 0) {
+        PBLOG_FATAL << "Could not open output file " << filename << " : " << std::strerror(errno);
+        std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+    }
+    file.Buffer.reset(new char[bufferSize_]);
+    files_.push_back(std::move(file));
+    return static_cast<int32_t>(files_.size() - 1);
+}
+
+void MultiFileWriter::Write(const int32_t file, std::string_view data)
+{
+    File& f = files_[file];
+    while (!data.empty()) {
+        const size_t n = std::min(data.size(), bufferSize_ - f.Fill);
+        std::memcpy(f.Buffer.get() + f.Fill, data.data(), n);
+        f.Fill += n;
+        data.remove_prefix(n);
+        if (f.Fill == bufferSize_) {
+            Submit(f);
+        }
+    }
+}
+
+void MultiFileWriter::Submit(File& file)
+{
+    if (file.Fill == 0) {
+        return;
+    }
+    file.Buffer = worker_->Submit(file.Fd, std::move(file.Buffer), file.Fill);
+    file.Fill = 0;
+}
+
+void MultiFileWriter::Close()
+{
+    if (!worker_) {
+        return;
+    }
+    for (auto& file : files_) {
+        Submit(file);
+    }
+    worker_->Drain();
+    worker_.reset();
+    for (const auto& file : files_) {
+        if (close(file.Fd) != 0) {
+            WriteFailed(errno);
+        }
+    }
+    files_.clear();
+}
+}  // namespace Harmony
+}  // namespace PacBio
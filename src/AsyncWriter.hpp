@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PacBio {
+namespace Harmony {
+
+///
+/// Buffered output that overlaps filesystem latency with the caller. Writes
+/// are collected into large page-aligned buffers; full buffers are submitted
+/// asynchronously while the next one fills, so a stalled write only blocks
+/// the caller once all buffers are in flight.
+///
+/// Regular files use io_uring if harmony was built with liburing and the
+/// kernel allows it. Otherwise, and for pipes such as stdout, a background
+/// thread issues blocking pwrite/write calls. Failing to open or write the
+/// output is fatal.
+///
+class AsyncWriter
+{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 4 << 20;
+    static constexpr int32_t DEFAULT_NUM_BUFFERS = 4;
+
+    class Backend;
+
+    ///
+    /// \param filename     output file, "-" for stdout
+    ///
+    explicit AsyncWriter(const std::string& filename, size_t bufferSize = DEFAULT_BUFFER_SIZE,
+                         int32_t numBuffers = DEFAULT_NUM_BUFFERS);
+    ~AsyncWriter();
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void Write(std::string_view data);
+
+    /// Submits the pending buffer, waits for all writes and closes the file
+    void Close();
+
+private:
+    struct FreeDeleter
+    {
+        void operator()(char* p) const;
+    };
+
+    void SubmitCurrent();
+
+    int fd_ = -1;
+    bool ownsFd_ = false;
+    const size_t bufferSize_;
+    std::vector<std::unique_ptr<char, FreeDeleter>> buffers_;
+    size_t current_ = 0;
+    size_t fill_ = 0;
+    int64_t offset_ = 0;
+    std::unique_ptr<Backend> backend_;
+};
+
+///
+/// Buffered output to many files through a single background thread. Every
+/// file owns one small buffer; full buffers are handed to the thread and
+/// replaced from a shared pool of spares, so memory is bounded by the number
+/// of files plus spares, times the buffer size. Failing to open or write a
+/// file is fatal. Not thread-safe.
+///
+class MultiFileWriter
+{
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 << 10;
+    static constexpr int32_t DEFAULT_NUM_SPARE_BUFFERS = 16;
+
+    explicit MultiFileWriter(size_t bufferSize = DEFAULT_BUFFER_SIZE,
+                             int32_t numSpareBuffers = DEFAULT_NUM_SPARE_BUFFERS);
+    ~MultiFileWriter();
+
+    MultiFileWriter(const MultiFileWriter&) = delete;
+    MultiFileWriter& operator=(const MultiFileWriter&) = delete;
+
+    /// \returns handle of the newly created file
+    int32_t Open(const std::string& filename);
+
+    void Write(int32_t file, std::string_view data);
+
+    /// Submits all pending buffers, waits for all writes and closes the files
+    void Close();
+
+private:
+    class Worker;
+
+    struct File
+    {
+        int Fd = -1;
+        std::unique_ptr<char[]> Buffer;
+        size_t Fill = 0;
+    };
+
+    void Submit(File& file);
+
+    const size_t bufferSize_;
+    std::vector<File> files_;
+    std::unique_ptr<Worker> worker_;
+};
+}  // namespace Harmony
+}  // namespace PacBio
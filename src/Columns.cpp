@@ -0,0 +1,137 @@
+#include "Columns.hpp"
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <stdexcept>
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+constexpr size_t NUM_COLUMNS = static_cast<size_t>(Column::NUM_COLUMNS);
+
+// clang-format off
+constexpr std::array<const char*, NUM_COLUMNS> COLUMN_NAMES{
+    "name", "passes", "ec", "rq", "seqlen", "alnlen", "concordance", "qv", "match", "mismatch",
+    "del", "ins", "del_events", "ins_events", "del_multi_events", "ins_multi_events",
+    "hard_clip", "sub", "ins_single", "del_single", "ins_all", "del_all"};
+// clang-format on
+
+constexpr Column FIRST_OPTIONAL = Column::HARD_CLIP;
+constexpr Column FIRST_EXTENDED = Column::SUB;
+
+bool IsExtended(const Column column) { return column >= FIRST_EXTENDED; }
+}  // namespace
+
+ColumnSet ColumnSet::FromString(const std::string& spec, const bool extendedMetrics)
+{
+    ColumnSet result;
+    if (spec.empty()) {
+        for (size_t i = 0; i < static_cast<size_t>(FIRST_OPTIONAL); ++i) {
+            result.Add(static_cast<Column>(i));
+        }
+    } else {
+        std::vector<std::string> names;
+        boost::split(names, spec, boost::is_any_of(","));
+        for (auto& name : names) {
+            boost::trim(name);
+            size_t i = 0;
+            while (i < NUM_COLUMNS && name != COLUMN_NAMES[i]) {
+                ++i;
+            }
+            if (i == NUM_COLUMNS) {
+                throw std::invalid_argument{"Unknown column '" + name +
+                                            "'. Available columns: " + AvailableNames()};
+            }
+            result.Add(static_cast<Column>(i));
+        }
+    }
+    if (extendedMetrics) {
+        for (size_t i = static_cast<size_t>(FIRST_EXTENDED); i < NUM_COLUMNS; ++i) {
+            result.Add(static_cast<Column>(i));
+        }
+    }
+    return result;
+}
+
+ColumnSet ColumnSet::All()
+{
+    ColumnSet result;
+    for (size_t i = 0; i < NUM_COLUMNS; ++i) {
+        result.Add(static_cast<Column>(i));
+    }
+    return result;
+}
+
+std::string ColumnSet::AvailableNames()
+{
+    std::string names;
+    for (const auto* name : COLUMN_NAMES) {
+        if (!names.empty()) {
+            names += ',';
+        }
+        names += name;
+    }
+    return names;
+}
+
+std::string ColumnSet::ToString() const
+{
+    std::string names;
+    for (const auto column : ordered_) {
+        if (!names.empty()) {
+            names += ',';
+        }
+        names += COLUMN_NAMES[static_cast<size_t>(column)];
+    }
+    return names;
+}
+
+bool ColumnSet::HasExtended() const
+{
+    for (size_t i = static_cast<size_t>(FIRST_EXTENDED); i < NUM_COLUMNS; ++i) {
+        if (mask_.test(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ColumnSet::Add(const Column column)
+{
+    if (!Has(column)) {
+        mask_.set(static_cast<size_t>(column));
+        ordered_.push_back(column);
+    }
+}
+
+void ColumnSet::WriteHeader(std::ostream& out) const
+{
+    bool first = true;
+    const auto sep = [&]() -> std::ostream& {
+        if (!first) {
+            out << ' ';
+        }
+        first = false;
+        return out;
+    };
+    for (const auto column : ordered_) {
+        const char* name = COLUMN_NAMES[static_cast<size_t>(column)];
+        if (!IsExtended(column)) {
+            sep() << name;
+        } else if (column == Column::DEL_SINGLE || column == Column::DEL_ALL) {
+            for (const auto refBase : BASES) {
+                sep() << name << '_' << refBase;
+            }
+        } else {
+            for (const auto refBase : BASES) {
+                for (const auto qryBase : BASES) {
+                    sep() << name << '_' << refBase << qryBase;
+                }
+            }
+        }
+    }
+    out << '\n';
+}
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace PacBio {
+namespace Harmony {
+
+inline constexpr std::array<char, 4> BASES{'A', 'C', 'G', 'T'};
+
+///
+/// Output columns. NAME .. INS_MULTI_EVENTS form the default schema,
+/// HARD_CLIP is opt-in. The extended groups (SUB .. DEL_ALL) each expand to
+/// one field per base or base pair and require a reference.
+///
+enum class Column : uint8_t
+{
+    NAME,
+    PASSES,
+    EC,
+    RQ,
+    SEQLEN,
+    ALNLEN,
+    CONCORDANCE,
+    QV,
+    MATCH,
+    MISMATCH,
+    DEL,
+    INS,
+    DEL_EVENTS,
+    INS_EVENTS,
+    DEL_MULTI_EVENTS,
+    INS_MULTI_EVENTS,
+    HARD_CLIP,
+    SUB,
+    INS_SINGLE,
+    DEL_SINGLE,
+    INS_ALL,
+    DEL_ALL,
+
+    NUM_COLUMNS
+};
+
+class ColumnSet
+{
+public:
+    ///
+    /// Parses a comma-separated list of column names. An empty spec selects
+    /// the default schema. With extendedMetrics, all extended groups that are
+    /// not explicitly listed are appended.
+    ///
+    /// \throws std::invalid_argument on unknown column names
+    ///
+    static ColumnSet FromString(const std::string& spec, bool extendedMetrics);
+
+    ///
+    /// \returns all columns, including the opt-in and extended ones
+    ///
+    static ColumnSet All();
+
+    ///
+    /// \returns comma-separated list of all valid column names
+    ///
+    static std::string AvailableNames();
+
+    bool Has(const Column column) const { return mask_.test(static_cast<size_t>(column)); }
+
+    /// \returns true if any of the per-base extended groups is selected
+    bool HasExtended() const;
+
+    const std::vector<Column>& Ordered() const { return ordered_; }
+
+    /// \returns comma-separated names of the selected columns, in order
+    std::string ToString() const;
+
+    void WriteHeader(std::ostream& out) const;
+
+private:
+    void Add(Column column);
+
+    std::vector<Column> ordered_;
+    std::bitset<static_cast<size_t>(Column::NUM_COLUMNS)> mask_;
+};
+}  // namespace Harmony
+}  // namespace PacBio
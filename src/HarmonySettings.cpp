@@ -32,9 +32,55 @@ R"({
     "type" : "bool"
 })"
 };
+const CLI_v2::Option Columns {
+R"({
+    "names" : ["columns"],
+    "description" : "Comma-separated list of output columns, in output order. Unrequested columns are not computed. Default: all non-extended columns.",
+    "type" : "string",
+    "default" : ""
+})"
+};
+const CLI_v2::Option CacheDir {
+R"({
+    "names" : ["cache-dir"],
+    "description" : "Cache per-BAM results in this directory. Reruns only process BAM files that are new or changed. Rows are then grouped by BAM file.",
+    "type" : "string",
+    "default" : ""
+})"
+};
+const CLI_v2::Option SplitBy {
+R"({
+    "names" : ["split-by"],
+    "description" : "Split outputs by read-group, movie or barcode in a single pass. Writes one output per partition and a summary, named after the output file.",
+    "type" : "string",
+    "default" : ""
+})"
+};
 // clang-format on
 }  // namespace OptionNames
 
+namespace {
+ColumnSet ParseColumns(const std::string& spec, const bool extendedMetrics)
+{
+    try {
+        return ColumnSet::FromString(spec, extendedMetrics);
+    } catch (const std::invalid_argument& e) {
+        PBLOG_FATAL << e.what();
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+SplitMode ParseSplitMode(const std::string& name)
+{
+    try {
+        return Partitioner::ModeFromString(name);
+    } catch (const std::invalid_argument& e) {
+        PBLOG_FATAL << e.what();
+        std::exit(EXIT_FAILURE);
+    }
+}
+}  // namespace
+
 HarmonySettings::HarmonySettings(const PacBio::CLI_v2::Results& options)
     : CLI(options.InputCommandLine())
     , LogFile(options[CLI_v2::Builtin::LogFile])
@@ -42,6 +88,9 @@ HarmonySettings::HarmonySettings(const PacBio::CLI_v2::Results& options)
     , Region(options[OptionNames::Region])
     , NumThreads(options.NumThreads())
     , ExtendedMatrics(options[OptionNames::ExtendedMatrics])
+    , Columns(ParseColumns(options[OptionNames::Columns], ExtendedMatrics))
+    , CacheDir(options[OptionNames::CacheDir])
+    , SplitBy(ParseSplitMode(options[OptionNames::SplitBy]))
 {
     if (FileNames.size() > 4 || FileNames.size() < 2) {
         PBLOG_FATAL
@@ -50,11 +99,28 @@ HarmonySettings::HarmonySettings(const PacBio::CLI_v2::Results& options)
         std::exit(EXIT_FAILURE);
     }
 
-    if ((ExtendedMatrics || !Region.empty()) && FileNames.size() != 3) {
+    if ((Columns.HasExtended() || !Region.empty()) && FileNames.size() != 3) {
         PBLOG_FATAL << "Please specify input alignment BAM file, reference FASTA file, and output "
                        "harmony TSV file. Please see --help for more information.";
         std::exit(EXIT_FAILURE);
     }
+
+    if (!CacheDir.empty() && FileNames[0] == "-") {
+        PBLOG_FATAL << "--cache-dir requires input files, it is not available for stdin.";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (SplitBy != SplitMode::NONE) {
+        if (FileNames[0] == "-" || FileNames.back() == "-") {
+            PBLOG_FATAL << "--split-by requires input and output files, stdin and stdout are not "
+                           "available.";
+            std::exit(EXIT_FAILURE);
+        }
+        if (!CacheDir.empty()) {
+            PBLOG_FATAL << "--split-by cannot be combined with --cache-dir.";
+            std::exit(EXIT_FAILURE);
+        }
+    }
 }
 
 CLI_v2::Interface HarmonySettings::CreateCLI()
@@ -71,7 +137,7 @@ CLI_v2::Interface HarmonySettings::CreateCLI()
     const CLI_v2::PositionalArgument inputAlignFile{
         R"({
         "name" : "IN.aligned.bam",
-        "description" : "Aligned BAM.",
+        "description" : "Aligned BAM, or - to stream an unindexed BAM from stdin.",
         "type" : "file",
         "required" : false
     })"};
@@ -85,13 +151,16 @@ CLI_v2::Interface HarmonySettings::CreateCLI()
     const CLI_v2::PositionalArgument outputHarmonyFile{
         R"({
         "name" : "OUT.harmony.txt",
-        "description" : "Harmony TXT.",
+        "description" : "Harmony TXT, or - for stdout.",
         "type" : "file",
         "required" : true
     })"};
     i.AddPositionalArguments({inputAlignFile, inputRefFile, outputHarmonyFile});
     i.AddOption(OptionNames::Region);
     i.AddOption(OptionNames::ExtendedMatrics);
+    i.AddOption(OptionNames::Columns);
+    i.AddOption(OptionNames::CacheDir);
+    i.AddOption(OptionNames::SplitBy);
 
     const auto printVersion = [](const CLI_v2::Interface& interface) {
         const std::string harmonyVersion = []() {
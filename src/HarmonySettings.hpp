@@ -2,6 +2,9 @@
 
 #include <pbcopper/cli2/CLI.h>
 
+#include "Columns.hpp"
+#include "Partitioner.hpp"
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -17,6 +20,9 @@ struct HarmonySettings
     const std::string Region;
     const int32_t NumThreads;
     const bool ExtendedMatrics;
+    const ColumnSet Columns;
+    const std::string CacheDir;
+    const SplitMode SplitBy;
 
     HarmonySettings(const PacBio::CLI_v2::Results& options);
 
@@ -0,0 +1,98 @@
+#include "MetricsAccumulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+template <typename T, typename U, size_t N>
+void AddCounts(std::array<T, N>& lhs, const std::array<U, N>& rhs)
+{
+    for (size_t i = 0; i < N; ++i) {
+        lhs[i] += rhs[i];
+    }
+}
+
+template <typename T, typename U, size_t N>
+void AddCounts(std::array<std::array<T, N>, N>& lhs, const std::array<std::array<U, N>, N>& rhs)
+{
+    for (size_t i = 0; i < N; ++i) {
+        AddCounts(lhs[i], rhs[i]);
+    }
+}
+}  // namespace
+
+void MetricsSummary::Add(const AlignmentMetrics& metrics)
+{
+    ++NumRecords;
+    AlnLen += metrics.AlnLen;
+    Match += metrics.Match;
+    Mismatch += metrics.Mismatch;
+    Del += metrics.Del;
+    Ins += metrics.Ins;
+    DelEvents += metrics.DelEvents;
+    InsEvents += metrics.InsEvents;
+    DelMultiEvents += metrics.DelMultiEvents;
+    InsMultiEvents += metrics.InsMultiEvents;
+    HardClip += metrics.HardClip;
+    AddCounts(Sub, metrics.Sub);
+    AddCounts(InsSingle, metrics.InsSingle);
+    AddCounts(DelSingle, metrics.DelSingle);
+    AddCounts(InsAll, metrics.InsAll);
+    AddCounts(DelAll, metrics.DelAll);
+}
+
+void MetricsSummary::Merge(const MetricsSummary& other)
+{
+    NumRecords += other.NumRecords;
+    AlnLen += other.AlnLen;
+    Match += other.Match;
+    Mismatch += other.Mismatch;
+    Del += other.Del;
+    Ins += other.Ins;
+    DelEvents += other.DelEvents;
+    InsEvents += other.InsEvents;
+    DelMultiEvents += other.DelMultiEvents;
+    InsMultiEvents += other.InsMultiEvents;
+    HardClip += other.HardClip;
+    AddCounts(Sub, other.Sub);
+    AddCounts(InsSingle, other.InsSingle);
+    AddCounts(DelSingle, other.DelSingle);
+    AddCounts(InsAll, other.InsAll);
+    AddCounts(DelAll, other.DelAll);
+}
+
+double MetricsSummary::Concordance() const
+{
+    if (AlnLen == 0) {
+        return 0;
+    }
+    return 1.0 - 1.0 * (Mismatch + Ins + Del) / AlnLen;
+}
+
+double MetricsSummary::Qv() const
+{
+    const double concordance = Concordance();
+    return concordance == 1 ? 60 : std::min(60.0, -10 * std::log10(1 - concordance));
+}
+
+void MetricsAccumulator::Add(const AlignmentMetrics& metrics)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    summary_.Add(metrics);
+}
+
+void MetricsAccumulator::Merge(const MetricsSummary& summary)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    summary_.Merge(summary);
+}
+
+MetricsSummary MetricsAccumulator::Summary() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return summary_;
+}
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include "AlignmentMetrics.hpp"
+
+namespace PacBio {
+namespace Harmony {
+
+///
+/// Totals over many alignments. Not synchronized; use one per thread and
+/// merge into a MetricsAccumulator.
+///
+struct MetricsSummary
+{
+    using BaseTotals = std::array<int64_t, BASES.size()>;
+    using BasePairTotals = std::array<BaseTotals, BASES.size()>;
+
+    int64_t NumRecords = 0;
+    int64_t AlnLen = 0;
+    int64_t Match = 0;
+    int64_t Mismatch = 0;
+    int64_t Del = 0;
+    int64_t Ins = 0;
+    int64_t DelEvents = 0;
+    int64_t InsEvents = 0;
+    int64_t DelMultiEvents = 0;
+    int64_t InsMultiEvents = 0;
+    int64_t HardClip = 0;
+
+    BasePairTotals Sub{};
+    BasePairTotals InsSingle{};
+    BaseTotals DelSingle{};
+    BasePairTotals InsAll{};
+    BaseTotals DelAll{};
+
+    void Add(const AlignmentMetrics& metrics);
+    void Merge(const MetricsSummary& other);
+
+    /// \returns 1 - (mismatch + ins + del) / alnlen over all alignments
+    double Concordance() const;
+    /// \returns Phred-scaled Concordance(), capped at 60
+    double Qv() const;
+};
+
+///
+/// Thread-safe accumulator of alignment metrics.
+///
+class MetricsAccumulator
+{
+public:
+    void Add(const AlignmentMetrics& metrics);
+
+    /// Merges a thread-local summary, one lock per batch instead of per record
+    void Merge(const MetricsSummary& summary);
+
+    MetricsSummary Summary() const;
+
+private:
+    mutable std::mutex mutex_;
+    MetricsSummary summary_;
+};
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,120 @@
+#include "Partitioner.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+std::string BarcodeName(const int32_t forward, const int32_t reverse)
+{
+    return std::to_string(forward) + "--" + std::to_string(reverse);
+}
+}  // namespace
+
+SplitMode Partitioner::ModeFromString(const std::string& name)
+{
+    if (name.empty()) {
+        return SplitMode::NONE;
+    }
+    if (name == "read-group") {
+        return SplitMode::READ_GROUP;
+    }
+    if (name == "movie") {
+        return SplitMode::MOVIE;
+    }
+    if (name == "barcode") {
+        return SplitMode::BARCODE;
+    }
+    throw std::invalid_argument{"Unknown split mode '" + name +
+                                "'. Available: read-group, movie, barcode"};
+}
+
+Partitioner::Partitioner(const SplitMode mode, const std::vector<BAM::ReadGroupInfo>& readGroups)
+    : mode_{mode}
+{
+    if (mode_ == SplitMode::NONE) {
+        return;
+    }
+    for (const auto& rg : readGroups) {
+        if (mode_ == SplitMode::BARCODE) {
+            if (const auto barcodes = rg.Barcodes()) {
+                readGroupToPartition_[rg.Id()] =
+                    AddPartition(BarcodeName(barcodes->first, barcodes->second));
+            }
+            continue;
+        }
+        readGroupToPartition_[rg.Id()] =
+            AddPartition(mode_ == SplitMode::MOVIE ? rg.MovieName() : rg.Id());
+    }
+}
+
+int32_t Partitioner::AddPartition(const std::string& key)
+{
+    const auto it = keyToPartition_.find(key);
+    if (it != keyToPartition_.cend()) {
+        return it->second;
+    }
+
+    // Barcoded read group ids look like "1234abcd/0--0". Sanitizing may map
+    // distinct keys such as "x/y" and "x_y" to the same name, so every
+    // partition gets a suffix until its name is unique and not reserved.
+    std::string base = key.empty() ? "unnamed" : key;
+    std::replace(base.begin(), base.end(), '/', '_');
+    std::string name = base;
+    for (int32_t suffix = 2; name == SUMMARY_NAME || usedNames_.count(name) > 0; ++suffix) {
+        name = base + '_' + std::to_string(suffix);
+    }
+
+    const auto partition = static_cast<int32_t>(names_.size());
+    names_.push_back(name);
+    usedNames_.insert(name);
+    keyToPartition_.emplace(key, partition);
+    return partition;
+}
+
+int32_t Partitioner::Partition(const BAM::BamRecord& record)
+{
+    if (mode_ == SplitMode::NONE) {
+        return 0;
+    }
+
+    // read group partitions are fixed after construction, no lock required
+    const std::string id = record.ReadGroupId();
+    const auto it = readGroupToPartition_.find(id);
+    if (it != readGroupToPartition_.cend()) {
+        return it->second;
+    }
+    if (mode_ == SplitMode::BARCODE) {
+        return BarcodePartition(record);
+    }
+    throw std::runtime_error{"Read group " + id + " is missing from the BAM header"};
+}
+
+// Read groups without barcodes in their id, barcodes only stored in the bc tag
+int32_t Partitioner::BarcodePartition(const BAM::BamRecord& record)
+{
+    std::string name{"unbarcoded"};
+    if (record.HasBarcodes()) {
+        const auto barcodes = record.Barcodes();
+        name = BarcodeName(barcodes.first, barcodes.second);
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock{mutex_};
+        const auto it = keyToPartition_.find(name);
+        if (it != keyToPartition_.cend()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock{mutex_};
+    return AddPartition(name);
+}
+
+std::string Partitioner::Name(const int32_t partition) const
+{
+    std::shared_lock<std::shared_mutex> lock{mutex_};
+    return names_.at(partition);
+}
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <pbbam/BamRecord.h>
+#include <pbbam/ReadGroupInfo.h>
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace PacBio {
+namespace Harmony {
+
+enum class SplitMode
+{
+    NONE,
+    READ_GROUP,
+    MOVIE,
+    BARCODE
+};
+
+///
+/// Assigns records to output partitions. Read group and movie partitions are
+/// resolved once from the header, as are barcode pairs of barcoded read groups
+/// ("<id>/<fwd>--<rev>"). Only barcode pairs that are solely stored in the
+/// records get their partition on first sight.
+///
+class Partitioner
+{
+public:
+    ///
+    /// \returns mode for "read-group", "movie" or "barcode", NONE for ""
+    /// \throws std::invalid_argument on any other name
+    ///
+    static SplitMode ModeFromString(const std::string& name);
+
+    /// Reserved for the per-partition totals, never used as a partition name
+    static constexpr char SUMMARY_NAME[] = "summary";  //NOLINT
+
+    Partitioner(SplitMode mode, const std::vector<BAM::ReadGroupInfo>& readGroups);
+
+    ///
+    /// Thread-safe.
+    ///
+    /// \throws std::runtime_error if the record's read group is not in the header
+    ///
+    int32_t Partition(const BAM::BamRecord& record);
+
+    /// \returns file name friendly partition name, unique among all
+    ///          partitions, thread-safe
+    std::string Name(int32_t partition) const;
+
+private:
+    int32_t AddPartition(const std::string& key);
+    int32_t BarcodePartition(const BAM::BamRecord& record);
+
+    const SplitMode mode_;
+    // guards partitions added after construction
+    mutable std::shared_mutex mutex_;
+    std::vector<std::string> names_;
+    std::unordered_set<std::string> usedNames_;
+    std::unordered_map<std::string, int32_t> keyToPartition_;
+    // read-only after construction
+    std::unordered_map<std::string, int32_t> readGroupToPartition_;
+};
+}  // namespace Harmony
+}  // namespace PacBio
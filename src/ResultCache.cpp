@@ -0,0 +1,216 @@
+#include "ResultCache.hpp"
+
+#include <pbcopper/logging/Logging.h>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+// FNV-1a, stable across platforms and builds unlike std::hash
+uint64_t Fnv1a(const std::string_view data)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+constexpr char ENTRY_EXTENSION[] = ".harmony";  //NOLINT
+constexpr char TMP_INFIX[] = ".tmp.";           //NOLINT
+
+std::string HostName()
+{
+    char name[HOST_NAME_MAX + 1] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0) {
+        return "localhost";
+    }
+    return name;
+}
+
+// Temporary entry files of this process. Fatal errors exit without running
+// the Entry destructors, so an exit handler removes whatever is left.
+class PendingFiles
+{
+public:
+    static PendingFiles& Instance()
+    {
+        // never destroyed, the exit handler may run after static destruction
+        static auto* instance = new PendingFiles;
+        return *instance;
+    }
+
+    void Add(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!handlerInstalled_) {
+            std::atexit(RemoveAll);
+            handlerInstalled_ = true;
+        }
+        paths_.insert(path);
+    }
+
+    void Remove(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        paths_.erase(path);
+    }
+
+private:
+    static void RemoveAll()
+    {
+        PendingFiles& self = Instance();
+        std::lock_guard<std::mutex> lock{self.mutex_};
+        for (const auto& path : self.paths_) {
+            unlink(path.c_str());
+        }
+        self.paths_.clear();
+    }
+
+    std::mutex mutex_;
+    std::unordered_set<std::string> paths_;
+    bool handlerInstalled_ = false;
+};
+}  // namespace
+
+ResultCache::Entry::Entry(std::string path, const std::string& key)
+    : path_{std::move(path)}
+    , tmpPath_{path_ + TMP_INFIX + HostName() + '.' + std::to_string(getpid())}
+{
+    PendingFiles::Instance().Add(tmpPath_);
+    writer_ = std::make_unique<AsyncWriter>(tmpPath_);
+
+    // the full key guards against hash collisions on replay
+    writer_->Write(key);
+    writer_->Write("\n");
+}
+
+ResultCache::Entry::~Entry()
+{
+    if (writer_ && !committed_) {
+        writer_->Close();
+        std::error_code ec;
+        std::filesystem::remove(tmpPath_, ec);
+        PendingFiles::Instance().Remove(tmpPath_);
+    }
+}
+
+void ResultCache::Entry::Commit()
+{
+    writer_->Close();
+    committed_ = true;
+    std::error_code ec;
+    std::filesystem::rename(tmpPath_, path_, ec);
+    if (ec) {
+        PBLOG_WARN << "Could not store cache entry " << path_ << " : " << ec.message();
+        std::filesystem::remove(tmpPath_, ec);
+    }
+    PendingFiles::Instance().Remove(tmpPath_);
+}
+
+ResultCache::ResultCache(std::string directory, std::string settingsKey)
+    : directory_{std::move(directory)}
+    , settingsKey_{"format " + std::to_string(FORMAT_VERSION) + '|' + std::move(settingsKey)}
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        PBLOG_FATAL << "Could not create cache directory " << directory_ << " : " << ec.message();
+        std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+    }
+    RemoveStaleEntries();
+}
+
+void ResultCache::RemoveStaleEntries() const
+{
+    // <hash>.harmony.tmp.<host>.<pid>; the directory may be shared between
+    // hosts, so only temporary files of this host can be checked
+    const std::string ownPrefix = std::string{ENTRY_EXTENSION} + TMP_INFIX + HostName() + '.';
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it{directory_, ec}, end; !ec && it != end;
+         it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        const auto prefix = name.find(ownPrefix);
+        if (prefix == std::string::npos) {
+            continue;
+        }
+        const std::string pid = name.substr(prefix + ownPrefix.size());
+        if (pid.empty() || pid.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        if (kill(std::stoi(pid), 0) != 0 && errno == ESRCH) {
+            std::error_code removeEc;
+            std::filesystem::remove(it->path(), removeEc);
+        }
+    }
+}
+
+std::string ResultCache::FileIdentity(const std::string& path)
+{
+    std::error_code ec;
+    const auto absolute = std::filesystem::absolute(path, ec);
+    const auto size = ec ? 0 : std::filesystem::file_size(absolute, ec);
+    const auto mtime =
+        ec ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(absolute, ec);
+    if (ec) {
+        PBLOG_FATAL << "Could not open input file " << path << " : " << ec.message();
+        std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+    }
+    return absolute.string() + ':' + std::to_string(size) + ':' +
+           std::to_string(mtime.time_since_epoch().count());
+}
+
+std::string ResultCache::Key(const std::string& bamFile) const
+{
+    return settingsKey_ + '|' + FileIdentity(bamFile);
+}
+
+std::string ResultCache::EntryPath(const std::string& key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << Fnv1a(key) << ENTRY_EXTENSION;
+    return (std::filesystem::path{directory_} / name.str()).string();
+}
+
+bool ResultCache::Replay(const std::string& bamFile, const RowSink& sink) const
+{
+    const std::string key = Key(bamFile);
+    std::ifstream in{EntryPath(key), std::ios::binary};
+    std::string storedKey;
+    if (!in || !std::getline(in, storedKey) || storedKey != key) {
+        return false;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        if (in.gcount() > 0) {
+            sink(std::string_view{buffer.data(), static_cast<size_t>(in.gcount())});
+        }
+    }
+    return true;
+}
+
+ResultCache::Entry ResultCache::Create(const std::string& bamFile) const
+{
+    const std::string key = Key(bamFile);
+    return Entry{EntryPath(key), key};
+}
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "AsyncWriter.hpp"
+
+namespace PacBio {
+namespace Harmony {
+
+///
+/// Per-BAM result cache. An entry holds the output rows of one BAM file and is
+/// keyed on the file's path, size and modification time, combined with a
+/// settings key that covers everything else the rows depend on (reference,
+/// columns, region, build). Reruns over a grown dataset only process BAM
+/// files without a valid entry.
+///
+class ResultCache
+{
+public:
+    using RowSink = std::function<void(std::string_view)>;
+
+    /// Bumped whenever the layout of an entry changes
+    static constexpr int32_t FORMAT_VERSION = 1;
+
+    ///
+    /// Rows of a BAM file being processed. The entry becomes visible to later
+    /// runs only after Commit(), so interrupted runs never leave partial
+    /// entries behind; the temporary file is removed on destruction and, as
+    /// fatal errors exit without unwinding, at process exit.
+    ///
+    class Entry
+    {
+    public:
+        Entry(std::string path, const std::string& key);
+        Entry(Entry&&) = default;
+        ~Entry();
+
+        void Write(std::string_view rows) { writer_->Write(rows); }
+        void Commit();
+
+    private:
+        std::string path_;
+        std::string tmpPath_;
+        std::unique_ptr<AsyncWriter> writer_;
+        bool committed_ = false;
+    };
+
+    ///
+    /// Creates the cache directory and removes temporary entries left behind
+    /// by dead processes on this host.
+    ///
+    ResultCache(std::string directory, std::string settingsKey);
+
+    ///
+    /// \returns identity of a file, consisting of its path, size and
+    ///          modification time; exits if the file cannot be accessed
+    ///
+    static std::string FileIdentity(const std::string& path);
+
+    ///
+    /// Streams the cached rows of bamFile into sink.
+    ///
+    /// \returns false if there is no valid entry for bamFile
+    ///
+    bool Replay(const std::string& bamFile, const RowSink& sink) const;
+
+    Entry Create(const std::string& bamFile) const;
+
+private:
+    std::string Key(const std::string& bamFile) const;
+    std::string EntryPath(const std::string& key) const;
+    void RemoveStaleEntries() const;
+
+    const std::string directory_;
+    const std::string settingsKey_;
+};
+}  // namespace Harmony
+}  // namespace PacBio
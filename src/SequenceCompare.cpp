@@ -0,0 +1,67 @@
+#include "SequenceCompare.hpp"
+
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+// Clearing bit 5 maps lower-case to upper-case letters, so soft-masked
+// reference bases compare equal to upper-case query bases.
+constexpr uint8_t CASE_MASK = 0xDF;
+}  // namespace
+
+int32_t CountMatches(const char* qry, const char* ref, const int32_t len)
+{
+    int32_t matches = 0;
+    int32_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i caseMask = _mm256_set1_epi8(static_cast<char>(CASE_MASK));
+    for (; i + 32 <= len; i += 32) {
+        const __m256i q = _mm256_and_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(qry + i)), caseMask);
+        const __m256i r = _mm256_and_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ref + i)), caseMask);
+        const auto eq = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(q, r)));
+        matches += std::popcount(eq);
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i caseMask128 = _mm_set1_epi8(static_cast<char>(CASE_MASK));
+    for (; i + 16 <= len; i += 16) {
+        const __m128i q =
+            _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(qry + i)), caseMask128);
+        const __m128i r =
+            _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + i)), caseMask128);
+        const auto eq = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(q, r)));
+        matches += std::popcount(eq);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t caseMask = vdupq_n_u8(CASE_MASK);
+    for (; i + 16 <= len; i += 16) {
+        const uint8x16_t q =
+            vandq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(qry + i)), caseMask);
+        const uint8x16_t r =
+            vandq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(ref + i)), caseMask);
+        // equal lanes are 0xFF, shift down to 1 and sum across the vector
+        matches += vaddvq_u8(vshrq_n_u8(vceqq_u8(q, r), 7));
+    }
+#endif
+
+    for (; i < len; ++i) {
+        matches += (static_cast<uint8_t>(qry[i]) & CASE_MASK) ==
+                   (static_cast<uint8_t>(ref[i]) & CASE_MASK);
+    }
+    return matches;
+}
+}  // namespace Harmony
+}  // namespace PacBio
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PacBio {
+namespace Harmony {
+
+///
+/// \returns number of positions in [0, len) at which the two sequences carry
+///          the same base, ignoring case. Vectorized with AVX2, SSE2 or NEON,
+///          whichever the target supports.
+///
+int32_t CountMatches(const char* qry, const char* ref, int32_t len);
+}  // namespace Harmony
+}  // namespace PacBio
@@ -10,6 +10,10 @@ BaiReader::BaiReader(const Data::GenomicInterval& interval, const PacBio::BAM::D
 
 bool BaiReader::GetNext(BAM::BamRecord& record) { return query_.GetNext(record); }
 
+StreamReader::StreamReader() : reader_{SimpleBamParser::STREAM_PATH} {}
+
+bool StreamReader::GetNext(BAM::BamRecord& record) { return reader_.GetNext(record); }
+
 AlignedCollator::AlignedCollator(std::vector<std::unique_ptr<BAM::BamReader>> readers)
 {
     for (auto&& reader : readers) {
@@ -54,9 +58,12 @@ bool AlignedCollator::GetNext(BAM::BamRecord& record)
     return true;
 }
 
-std::vector<std::unique_ptr<BAM::BamReader>> SimpleBamParser::GetBamReaders(
-    const std::string& filePath, const BAM::PbiFilter& filter)
+std::vector<std::string> SimpleBamParser::GetBamFileNames(const std::string& filePath)
 {
+    if (!Utility::FileExists(filePath)) {
+        PBLOG_FATAL << "Could not open input file " << filePath;
+        std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+    }
     BAM::DataSet ds(filePath);
     std::vector<std::string> inputFilenames;
     const auto& bamFiles = ds.BamFiles();
@@ -64,7 +71,18 @@ std::vector<std::unique_ptr<BAM::BamReader>> SimpleBamParser::GetBamReaders(
     for (const auto& file : bamFiles) {
         inputFilenames.push_back(file.Filename());
     }
+    return inputFilenames;
+}
 
+bool SimpleBamParser::HasDataSetFilters(const std::string& filePath)
+{
+    return !BAM::PbiFilter::FromDataSet(BAM::DataSet{filePath}).IsEmpty();
+}
+
+std::vector<std::unique_ptr<BAM::BamReader>> SimpleBamParser::GetBamReaders(
+    const std::string& filePath, const BAM::PbiFilter& filter)
+{
+    const std::vector<std::string> inputFilenames = GetBamFileNames(filePath);
     if (inputFilenames.empty()) {
         throw std::runtime_error("no input filenames provided to BamFileMerger");
     }
@@ -85,6 +103,13 @@ std::vector<std::unique_ptr<BAM::BamReader>> SimpleBamParser::GetBamReaders(
 std::unique_ptr<ReaderBase> SimpleBamParser::BamQuery(const std::string& filePath,
                                                       const std::string& userFilters)
 {
+    if (filePath == STREAM_PATH) {
+        if (!userFilters.empty()) {
+            PBLOG_FATAL << "Region filtering requires an indexed input file, not stdin.";
+            std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+        }
+        return std::make_unique<StreamReader>();
+    }
     if (!Utility::FileExists(filePath)) {
         PBLOG_FATAL << "Could not open input file " << filePath;
         std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
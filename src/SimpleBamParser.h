@@ -42,6 +42,19 @@ private:
     BAM::GenomicIntervalCompositeBamReader query_;
 };
 
+// Reads an unindexed BAM stream from stdin in arrival order
+class StreamReader : public ReaderBase
+{
+public:
+    StreamReader();
+    ~StreamReader() override = default;
+
+    bool GetNext(BAM::BamRecord& record) override;
+
+private:
+    BAM::BamReader reader_;
+};
+
 class AlignedCollator : public ReaderBase
 {
 public:
@@ -58,6 +71,12 @@ private:
 
 struct SimpleBamParser
 {
+    static constexpr char STREAM_PATH[] = "-";  //NOLINT
+
+    static std::vector<std::string> GetBamFileNames(const std::string& filePath);
+
+    static bool HasDataSetFilters(const std::string& filePath);
+
     static std::vector<std::unique_ptr<BAM::BamReader>> GetBamReaders(const std::string& filePath,
                                                                       const BAM::PbiFilter& filter);
 
@@ -0,0 +1,212 @@
+#include "ThreadBudget.hpp"
+
+#include <pbcopper/logging/Logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace PacBio {
+namespace Harmony {
+namespace {
+
+// Combines two limits where 0 means unlimited
+int32_t MinLimit(const int32_t a, const int32_t b)
+{
+    if (a == 0 || b == 0) {
+        return std::max(a, b);
+    }
+    return std::min(a, b);
+}
+
+int32_t QuotaToCpus(const double quota, const double period)
+{
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return std::max(1, static_cast<int32_t>(std::floor(quota / period)));
+}
+
+// \returns CPU limit of a single cgroup directory, 0 if unlimited or unknown
+int32_t DirectoryCpuLimit(const std::string& dir, const bool v2)
+{
+    if (v2) {
+        // "<quota> <period>" or "max <period>"
+        std::ifstream cpuMax{dir + "/cpu.max"};
+        std::string quota;
+        double period = 0;
+        if (cpuMax >> quota >> period && quota != "max") {
+            return QuotaToCpus(std::stod(quota), period);
+        }
+        return 0;
+    }
+
+    // quota of -1 means unlimited
+    std::ifstream cfsQuota{dir + "/cpu.cfs_quota_us"};
+    std::ifstream cfsPeriod{dir + "/cpu.cfs_period_us"};
+    double quota = 0;
+    double period = 0;
+    if (cfsQuota >> quota && cfsPeriod >> period) {
+        return QuotaToCpus(quota, period);
+    }
+    return 0;
+}
+
+bool HasToken(const std::string& list, const std::string& token)
+{
+    std::istringstream in{list};
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (item == token) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct CgroupMount
+{
+    std::string MountPoint;
+    // cgroup that is mounted at MountPoint, "/" unless inside a container
+    std::string Root;
+};
+
+// \returns mount of the cgroup v2 hierarchy or of the v1 cpu controller
+std::optional<CgroupMount> FindCgroupMount(const bool v2)
+{
+    std::ifstream mountInfo{"/proc/self/mountinfo"};
+    std::string line;
+    while (std::getline(mountInfo, line)) {
+        // <id> <parent> <dev> <root> <mount point> <options> [<tags>] - <type> <source> <options>
+        const auto separator = line.find(" - ");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::istringstream mountFields{line.substr(0, separator)};
+        std::istringstream fsFields{line.substr(separator + 3)};
+        std::string id;
+        std::string parent;
+        std::string dev;
+        CgroupMount mount;
+        std::string type;
+        std::string source;
+        std::string superOptions;
+        if (!(mountFields >> id >> parent >> dev >> mount.Root >> mount.MountPoint) ||
+            !(fsFields >> type >> source >> superOptions)) {
+            continue;
+        }
+        if (v2 ? type == "cgroup2" : type == "cgroup" && HasToken(superOptions, "cpu")) {
+            return mount;
+        }
+    }
+    return {};
+}
+
+// \returns smallest CPU limit of the cgroup at path and all of its ancestors
+int32_t HierarchyCpuLimit(const CgroupMount& mount, std::string path, const bool v2)
+{
+    if (mount.Root != "/" && path.compare(0, mount.Root.size(), mount.Root) == 0) {
+        path.erase(0, mount.Root.size());
+    }
+    int32_t limit = 0;
+    while (true) {
+        limit = MinLimit(limit, DirectoryCpuLimit(mount.MountPoint + path, v2));
+        const auto slash = path.rfind('/');
+        if (slash == std::string::npos || path.size() <= 1) {
+            return limit;
+        }
+        path.resize(slash);
+    }
+}
+
+// \returns CPU limit imposed by the cgroup quotas of this process and its
+//          parent cgroups, 0 if unlimited or unknown
+int32_t CgroupCpuLimit()
+{
+    // "0::<path>" for cgroup v2, "<id>:<controllers>:<path>" for v1
+    std::ifstream procCgroup{"/proc/self/cgroup"};
+    std::string line;
+    int32_t limit = 0;
+    while (std::getline(procCgroup, line)) {
+        const auto first = line.find(':');
+        const auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        const std::string controllers = line.substr(first + 1, second - first - 1);
+        const bool v2 = controllers.empty();
+        if (!v2 && !HasToken(controllers, "cpu")) {
+            continue;
+        }
+        if (const auto mount = FindCgroupMount(v2)) {
+            limit = MinLimit(limit, HierarchyCpuLimit(*mount, line.substr(second + 1), v2));
+        }
+    }
+    return limit;
+}
+}  // namespace
+
+int32_t AvailableCpus()
+{
+    auto cpus = static_cast<int32_t>(std::max(1U, std::thread::hardware_concurrency()));
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        cpus = std::max(1, CPU_COUNT(&mask));
+    }
+#endif
+    if (const int32_t quota = CgroupCpuLimit(); quota > 0) {
+        cpus = std::min(cpus, quota);
+    }
+    return cpus;
+}
+
+ThreadBudget ThreadBudget::Compute(const int32_t requested, const int32_t numBamFiles,
+                                   const bool heavyParsing)
+{
+    ThreadBudget budget;
+    const int32_t available = AvailableCpus();
+    budget.Total = std::max(1, std::min(requested, available));
+    if (budget.Total < requested) {
+        PBLOG_WARN << "Requested " << requested << " threads, but only " << available
+                   << " CPUs are available to this process. Using " << budget.Total << '.';
+    }
+    // With two threads, a parse worker would compete with the producer and
+    // the writer; parsing inline on the producer leaves the second CPU to the
+    // output I/O thread.
+    if (budget.Total <= 2) {
+        return budget;
+    }
+
+    // The producer thread and the writer take two slots. The writer slot is
+    // shared by the ordered consumer and the output I/O threads, which mostly
+    // block on write. Of the rest, decompression gets a share that reflects
+    // how expensive a record is to parse relative to inflating it; parsing
+    // with per-base counters is several times slower than BGZF decompression.
+    const int32_t remaining = budget.Total - 2;
+    const int32_t decompShare = heavyParsing ? 6 : 3;
+    const int32_t decompTotal = remaining / decompShare;
+
+    // Every BAM reader owns its own htslib pool. A pool of one thread only
+    // adds hand-off overhead, so readers below two threads decompress inline
+    // on the producer thread.
+    const int32_t perReader = decompTotal / std::max(1, numBamFiles);
+    budget.DecompThreads = perReader >= 2 ? perReader : 1;
+    const int32_t decompUsed = budget.DecompThreads > 1 ? budget.DecompThreads * numBamFiles : 0;
+    budget.WorkerThreads = std::max(1, remaining - decompUsed);
+
+    PBLOG_INFO << "Thread budget " << budget.Total << " : " << budget.WorkerThreads << " parse, "
+               << decompUsed << " decompression, 1 reader, 1 writer";
+    return budget;
+}
+}  // namespace Harmony
+}  // namespace PacBio
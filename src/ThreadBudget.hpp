@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PacBio {
+namespace Harmony {
+
+///
+/// Splits the thread budget across the pipeline stages. The producer thread
+/// (BAM iteration) and the writer (ordered consumer plus output I/O) are part
+/// of the budget, so that the total number of busy threads never exceeds what
+/// was requested, nor the number of CPUs available to the process (affinity
+/// mask, cgroup quota).
+///
+struct ThreadBudget
+{
+    /// Effective budget after clamping to the available CPUs
+    int32_t Total = 1;
+    /// BGZF decompression threads per BAM reader, 1 disables the htslib pool
+    int32_t DecompThreads = 1;
+    /// Parse workers of the WorkQueue, 0 parses inline on the producer thread
+    int32_t WorkerThreads = 0;
+
+    ///
+    /// \param requested        number of threads requested via --num-threads
+    /// \param numBamFiles      number of concurrently open BAM readers
+    /// \param heavyParsing     parsing includes per-base extended metrics
+    ///
+    static ThreadBudget Compute(int32_t requested, int32_t numBamFiles, bool heavyParsing);
+};
+
+///
+/// \returns number of CPUs usable by this process, honoring the affinity mask
+///          and the cgroup (v1 or v2) CPU quota
+///
+int32_t AvailableCpus();
+}  // namespace Harmony
+}  // namespace PacBio
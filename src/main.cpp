@@ -1,11 +1,16 @@
+#include "AlignmentMetrics.hpp"
+#include "AsyncWriter.hpp"
+#include "Columns.hpp"
 #include "HarmonySettings.hpp"
 #include "LibraryInfo.hpp"
+#include "MetricsAccumulator.hpp"
+#include "Partitioner.hpp"
+#include "ResultCache.hpp"
 #include "SimpleBamParser.h"
+#include "ThreadBudget.hpp"
 
 #include <htslib/hts.h>
 #include <pbbam/BamRecord.h>
-#include <pbbam/FastaReader.h>
-#include <pbbam/IndexedFastaReader.h>
 #include <pbbam/PbbamVersion.h>
 #include <pbcopper/cli2/CLI.h>
 #include <pbcopper/cli2/internal/BuiltinOptions.h>
@@ -16,32 +21,22 @@
 #include <pbcopper/utility/Stopwatch.h>
 #include <zlib.h>
 
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/version.hpp>
-#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 
 namespace PacBio {
 namespace Harmony {
 
-static constexpr std::array<char, 4> BASES{'A', 'C', 'G', 'T'};
-
-std::unordered_map<std::string, std::string> ReadRefs(const std::string& refFile)
-{
-    std::unordered_map<std::string, std::string> refs;
-    PacBio::BAM::FastaReader fastaReader{refFile};
-    PacBio::BAM::FastaSequence fasta;
-    while (fastaReader.GetNext(fasta)) {
-        refs.insert({fasta.Name(), fasta.Bases()});
-    }
-    return refs;
-}
-
 void SetBamReaderDecompThreads(const int32_t numThreads)
 {
     static constexpr char BAMREADER_ENV[] = "PB_BAMREADER_THREADS";  //NOLINT
@@ -49,263 +44,210 @@ void SetBamReaderDecompThreads(const int32_t numThreads)
     setenv(BAMREADER_ENV, decompThreads.c_str(), true);  //NOLINT(concurrency-mt-unsafe)
 }
 
-std::string ParseAlignment(const BAM::BamRecord& record,
-                           const std::unordered_map<std::string, std::string>& refs,
-                           const bool extendedMetrics)
+std::string FormatMetrics(const AlignmentMetrics& m, const ColumnSet& columns)
 {
     std::ostringstream out;
-    std::map<char, std::map<char, int32_t>> singleBase;
-    std::map<char, int32_t> singleBaseDel;
-    std::map<char, int32_t> allBaseDel;
-    std::map<char, std::map<char, int32_t>> singleBaseIns;
-    std::map<char, std::map<char, int32_t>> allBaseIns;
-    int32_t ins = 0;
-    int32_t del = 0;
-    int32_t insEvents = 0;
-    int32_t delEvents = 0;
-    int32_t insMultiEvents = 0;
-    int32_t delMultiEvents = 0;
-    int32_t mismatch = 0;
-    int32_t match = 0;
-    std::string ref;
-    if (refs.find(record.ReferenceName()) != refs.cend()) {
-        ref = refs.at(record.ReferenceName())
-                  .substr(record.ReferenceStart(), record.ReferenceEnd() - record.ReferenceStart());
-    }
-    int32_t qryPos = 0;
-    int32_t refPos = 0;
-    const auto qry = record.Sequence(Data::Orientation::GENOMIC);
-    for (const auto& cigar : record.CigarData()) {
-        int32_t len = cigar.Length();
-        switch (cigar.Type()) {
-            case Data::CigarOperationType::INSERTION:
-                if (extendedMetrics && !ref.empty()) {
-                    ++singleBaseIns[ref[refPos]][qry[qryPos]];
-                }
-                ++insEvents;
-                if (len > 1) {
-                    ++insMultiEvents;
-                }
-                ins += len;
-                qryPos += len;
+    bool first = true;
+    const auto field = [&](const auto& value) {
+        if (!first) {
+            out << ' ';
+        }
+        first = false;
+        out << value;
+    };
+    const auto pairCounts = [&](const BasePairCounts& counts) {
+        for (const auto& refCounts : counts) {
+            for (const auto count : refCounts) {
+                field(count);
+            }
+        }
+    };
+    const auto baseCounts = [&](const BaseCounts& counts) {
+        for (const auto count : counts) {
+            field(count);
+        }
+    };
+
+    for (const auto column : columns.Ordered()) {
+        switch (column) {
+            case Column::NAME:
+                field(m.Name);
                 break;
-            case Data::CigarOperationType::DELETION:
-                if (extendedMetrics && !ref.empty()) {
-                    ++singleBaseDel[ref[refPos]];
-                    for (int32_t i = 0; i < len; ++i) {
-                        ++allBaseDel[ref[refPos + i]];
-                    }
-                }
-                ++delEvents;
-                if (len > 1) {
-                    ++delMultiEvents;
-                }
-                del += len;
-                refPos += len;
+            case Column::PASSES:
+                field(m.NumPasses);
                 break;
-            case Data::CigarOperationType::SEQUENCE_MISMATCH:
-                if (extendedMetrics && !ref.empty()) {
-                    for (int32_t i = 0; i < len; ++i) {
-                        ++singleBase[ref[refPos + i]][qry[qryPos + i]];
-                    }
-                }
-                mismatch += len;
-                refPos += len;
-                qryPos += len;
+            case Column::EC:
+                field(m.Ec);
                 break;
-            case Data::CigarOperationType::SEQUENCE_MATCH:
-                if (extendedMetrics && !ref.empty()) {
-                    for (int32_t i = 0; i < len; ++i) {
-                        ++singleBase[ref[refPos + i]][qry[qryPos + i]];
-                    }
-                }
-                refPos += len;
-                qryPos += len;
-                match += len;
+            case Column::RQ:
+                field(m.Rq);
                 break;
-            case Data::CigarOperationType::SOFT_CLIP:
-                qryPos += len;
+            case Column::SEQLEN:
+                field(m.SeqLen);
                 break;
-            case Data::CigarOperationType::ALIGNMENT_MATCH:
-                PBLOG_FATAL << "UNSUPPORTED OPERATION: ALIGNMENT MATCH";
-                std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
-            case Data::CigarOperationType::REFERENCE_SKIP:
-                PBLOG_FATAL << "UNSUPPORTED OPERATION: REFERENCE SKIP";
-                std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
-            case Data::CigarOperationType::HARD_CLIP:
-                PBLOG_FATAL << "UNSUPPORTED OPERATION: HARD CLIP";
-                std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
-            case Data::CigarOperationType::PADDING:
-                PBLOG_FATAL << "UNSUPPORTED OPERATION: PADDING";
-                std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
-            case Data::CigarOperationType::UNKNOWN_OP:
-            default:
-                PBLOG_FATAL << "UNKNOWN OP";
-                std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+            case Column::ALNLEN:
+                field(m.AlnLen);
+                break;
+            case Column::CONCORDANCE:
+                field(m.Concordance);
+                break;
+            case Column::QV:
+                field(m.Qv);
+                break;
+            case Column::MATCH:
+                field(m.Match);
+                break;
+            case Column::MISMATCH:
+                field(m.Mismatch);
+                break;
+            case Column::DEL:
+                field(m.Del);
+                break;
+            case Column::INS:
+                field(m.Ins);
+                break;
+            case Column::DEL_EVENTS:
+                field(m.DelEvents);
+                break;
+            case Column::INS_EVENTS:
+                field(m.InsEvents);
+                break;
+            case Column::DEL_MULTI_EVENTS:
+                field(m.DelMultiEvents);
+                break;
+            case Column::INS_MULTI_EVENTS:
+                field(m.InsMultiEvents);
+                break;
+            case Column::HARD_CLIP:
+                field(m.HardClip);
+                break;
+            case Column::SUB:
+                pairCounts(m.Sub);
+                break;
+            case Column::INS_SINGLE:
+                pairCounts(m.InsSingle);
+                break;
+            case Column::DEL_SINGLE:
+                baseCounts(m.DelSingle);
+                break;
+            case Column::INS_ALL:
+                pairCounts(m.InsAll);
+                break;
+            case Column::DEL_ALL:
+                baseCounts(m.DelAll);
+                break;
+            case Column::NUM_COLUMNS:
                 break;
-        }
-    }
-    const int32_t span = record.AlignedEnd() - record.AlignedStart();
-    const int32_t nErr = ins + del + mismatch;
-    const int32_t numAlignedBases = match + ins + mismatch;
-    const double concordance = 1.0 - 1.0 * nErr / span;
-    const int32_t qv = concordance == 1 ? 60 : (-10 * std::log10(1 - concordance));
-    const int32_t numPasses = record.HasNumPasses() ? record.NumPasses() : -1;
-    const int32_t ec = record.Impl().HasTag("ec") ? record.Impl().TagValue("ec").ToFloat() : -1;
-    const std::string name = record.FullName();
-    const float rq = record.HasReadAccuracy() ? static_cast<float>(record.ReadAccuracy()) : -1.f;
-    const int32_t seqlen = qry.size();
-
-    out << name << ' ' << numPasses << ' ' << ec << ' ' << rq << ' ' << seqlen << ' '
-        << numAlignedBases << ' ' << concordance << ' ' << qv << ' ' << match << ' ' << mismatch
-        << ' ' << del << ' ' << ins << ' ' << delEvents << ' ' << insEvents << ' ' << delMultiEvents
-        << ' ' << insMultiEvents;
-    if (extendedMetrics) {
-        for (const auto refBase : BASES) {
-            for (const auto qryBase : BASES) {
-                if (singleBase.find(refBase) == singleBase.cend() ||
-                    singleBase.at(refBase).find(qryBase) == singleBase.at(refBase).cend()) {
-                    out << ' ' << 0;
-                } else {
-                    out << ' ' << singleBase.at(refBase).at(qryBase);
-                }
-            }
-        }
-        for (const auto refBase : BASES) {
-            for (const auto qryBase : BASES) {
-                if (singleBaseIns.find(refBase) == singleBaseIns.cend() ||
-                    singleBaseIns.at(refBase).find(qryBase) == singleBaseIns.at(refBase).cend()) {
-                    out << ' ' << 0;
-                } else {
-                    out << ' ' << singleBaseIns.at(refBase).at(qryBase);
-                }
-            }
-        }
-        for (const auto refBase : BASES) {
-            if (singleBaseDel.find(refBase) == singleBaseDel.cend()) {
-                out << ' ' << 0;
-            } else {
-                out << ' ' << singleBaseDel.at(refBase);
-            }
-        }
-        for (const auto refBase : BASES) {
-            for (const auto qryBase : BASES) {
-                if (allBaseIns.find(refBase) == allBaseIns.cend() ||
-                    allBaseIns.at(refBase).find(qryBase) == allBaseIns.at(refBase).cend()) {
-                    out << ' ' << 0;
-                } else {
-                    out << ' ' << allBaseIns.at(refBase).at(qryBase);
-                }
-            }
-        }
-        for (const auto& refBase : BASES) {
-            if (allBaseDel.find(refBase) == allBaseDel.cend()) {
-                out << ' ' << 0;
-            } else {
-                out << ' ' << allBaseDel.at(refBase);
-            }
         }
     }
     out << '\n';
     return out.str();
 }
 
-void WorkerThread(Parallel::WorkQueue<std::vector<std::string>>& queue, std::ofstream& writer)
+// Parse workers may fail concurrently. Only the first error is reported, the
+// others block until the process has exited. Exit handlers still run, so
+// temporary cache entries are removed.
+[[noreturn]] void RecordFailed(const std::string& message)
 {
-    int32_t counter = 0;
+    static auto* const firstError = new std::mutex;
+    firstError->lock();
+    PBLOG_FATAL << message;
+    std::exit(EXIT_FAILURE);  //NOLINT(concurrency-mt-unsafe)
+}
 
-    const auto lambdaWorker = [&](std::vector<std::string>&& ps) {
-        for (const auto& s : ps) {
-            if (++counter % 1000 == 0) {
-                PBLOG_INFO << counter;
-            }
-            writer << s;
-        }
-    };
+// Reads the reference on first use, so that runs over =/X alignments without
+// extended columns never load it
+class LazyReferences
+{
+public:
+    explicit LazyReferences(std::string refFile) : refFile_{std::move(refFile)} {}
 
-    while (queue.ConsumeWith(lambdaWorker)) {
+    const References& Get()
+    {
+        std::call_once(loaded_, [this]() {
+            if (refFile_.empty()) {
+                return;
+            }
+            PBLOG_INFO << "Start reading reference";
+            refs_ = ReadReferences(refFile_);
+            PBLOG_INFO << "Finished reading reference";
+        });
+        return refs_;
     }
-}
 
-int RunnerSubroutine(const CLI_v2::Results& options)
+private:
+    const std::string refFile_;
+    std::once_flag loaded_;
+    References refs_;
+};
+
+AlignmentMetrics ParseAlignment(const BAM::BamRecord& record, const ReferenceSource& refs,
+                                const ColumnSet& columns)
 {
-    Utility::Stopwatch globalTimer;
-    HarmonySettings settings{options};
-    SetBamReaderDecompThreads(settings.NumThreads);
+    try {
+        return ComputeMetrics(record, refs, columns);
+    } catch (const std::exception& e) {
+        RecordFailed(e.what());
+    }
+}
 
-    const bool hasRef{boost::iends_with(settings.FileNames[1], ".fa") ||
-                      boost::iends_with(settings.FileNames[1], ".fasta") ||
-                      boost::iends_with(settings.FileNames[1], ".fa.gz") ||
-                      boost::iends_with(settings.FileNames[1], ".fasta.gz")};
-    const std::string alnFile{settings.FileNames[0]};
+using RowSink = ResultCache::RowSink;
 
-    std::unique_ptr<ReaderBase> alnReader = SimpleBamParser::BamQuery(alnFile, settings.Region);
-    std::unordered_map<std::string, std::string> refs;
-    if (hasRef) {
-        PBLOG_INFO << "Start reading reference";
-        refs = ReadRefs(settings.FileNames[1]);
-        PBLOG_INFO << "Finished reading reference";
-    }
+template <typename T>
+using RecordParser = std::function<T(const BAM::BamRecord&)>;
 
-    std::array<char, 4> bases = {'A', 'C', 'G', 'T'};
-    BAM::BamRecord record;
+template <typename T>
+using ResultConsumer = std::function<void(T&&)>;
 
-    std::ofstream outputFile{hasRef ? settings.FileNames[2] : settings.FileNames[1]};
+template <typename T>
+void WorkerThread(Parallel::WorkQueue<std::vector<T>>& queue, const ResultConsumer<T>& consume)
+{
+    int32_t counter = 0;
 
-    outputFile << "name" << ' ' << "passes" << ' ' << "ec" << ' ' << "rq" << ' ' << "seqlen" << ' '
-               << "alnlen" << ' ' << "concordance" << ' ' << "qv" << ' ' << "match" << ' '
-               << "mismatch" << ' ' << "del" << ' ' << "ins" << ' ' << "del_events" << ' '
-               << "ins_events" << ' ' << "del_multi_events" << ' ' << "ins_multi_events";
-    if (settings.ExtendedMatrics) {
-        for (const auto& refBase : bases) {
-            for (const auto& qryBase : bases) {
-                outputFile << " sub_" << refBase << qryBase;
-            }
-        }
-        for (const auto& refBase : bases) {
-            for (const auto& qryBase : bases) {
-                outputFile << " ins_single_" << refBase << qryBase;
-            }
-        }
-        for (const auto& refBase : bases) {
-            outputFile << " del_single_" << refBase;
-        }
-        for (const auto& refBase : bases) {
-            for (const auto& qryBase : bases) {
-                outputFile << " ins_all_" << refBase << qryBase;
+    const auto lambdaWorker = [&](std::vector<T>&& ps) {
+        for (auto& p : ps) {
+            if (++counter % 1000 == 0) {
+                PBLOG_INFO << counter;
             }
+            consume(std::move(p));
         }
-        for (const auto& refBase : bases) {
-            outputFile << " del_all_" << refBase;
-        }
+    };
+
+    while (queue.ConsumeWith(lambdaWorker)) {
     }
-    outputFile << '\n';
+}
 
-    if (settings.NumThreads == 1) {
+// Runs parse on the parse workers and hands the results to consume on a
+// single thread, in input order.
+template <typename T>
+void ProcessRecords(ReaderBase& reader, const ThreadBudget& budget, const RecordParser<T>& parse,
+                    const ResultConsumer<T>& consume)
+{
+    BAM::BamRecord record;
+    if (budget.WorkerThreads == 0) {
         int32_t counter = 0;
-        while (alnReader->GetNext(record)) {
+        while (reader.GetNext(record)) {
             if (++counter % 1000 == 0) {
                 PBLOG_INFO << counter;
             }
-            outputFile << ParseAlignment(record, refs, settings.ExtendedMatrics);
+            consume(parse(record));
         }
     } else {
-        Parallel::WorkQueue<std::vector<std::string>> workQueue(settings.NumThreads, 10);
-        std::future<void> workerThread =
-            std::async(std::launch::async, WorkerThread, std::ref(workQueue), std::ref(outputFile));
-
-        const auto submit = [&refs, extendedMetrics = settings.ExtendedMatrics](
-                                const std::vector<BAM::BamRecord>& records) {
-            std::vector<std::string> ss;
-            ss.reserve(records.size());
+        Parallel::WorkQueue<std::vector<T>> workQueue(budget.WorkerThreads, 10);
+        std::future<void> workerThread = std::async(std::launch::async, WorkerThread<T>,
+                                                    std::ref(workQueue), std::cref(consume));
+
+        const auto submit = [&parse](const std::vector<BAM::BamRecord>& records) {
+            std::vector<T> ts;
+            ts.reserve(records.size());
             for (const auto& record : records) {
-                ss.emplace_back(ParseAlignment(record, refs, extendedMetrics));
+                ts.emplace_back(parse(record));
             }
-            return ss;
+            return ts;
         };
 
         std::vector<BAM::BamRecord> chunk;
-        while (alnReader->GetNext(record)) {
+        while (reader.GetNext(record)) {
             if (chunk.size() == 5) {
                 workQueue.ProduceWith(submit, std::move(chunk));
                 chunk = {};
@@ -320,6 +262,206 @@ int RunnerSubroutine(const CLI_v2::Results& options)
         workerThread.wait();
         workQueue.Finalize();
     }
+}
+
+struct PartitionedRow
+{
+    int32_t Partition = 0;
+    std::string Row;
+    AlignmentMetrics Metrics;
+};
+
+// out.txt -> out.<name>.txt
+std::string PartitionPath(const std::string& outFile, const std::string& name)
+{
+    static const std::string EXTENSION{".txt"};
+    std::string prefix = outFile;
+    if (boost::iends_with(prefix, EXTENSION)) {
+        prefix.resize(prefix.size() - EXTENSION.size());
+    }
+    return prefix + '.' + name + EXTENSION;
+}
+
+void WriteSummary(const std::string& path, const std::vector<std::string>& names,
+                  const std::vector<MetricsSummary>& summaries)
+{
+    std::ostringstream out;
+    out << "partition records alnlen match mismatch del ins del_events ins_events "
+           "del_multi_events ins_multi_events concordance qv\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        const MetricsSummary& s = summaries[i];
+        out << names[i] << ' ' << s.NumRecords << ' ' << s.AlnLen << ' ' << s.Match << ' '
+            << s.Mismatch << ' ' << s.Del << ' ' << s.Ins << ' ' << s.DelEvents << ' '
+            << s.InsEvents << ' ' << s.DelMultiEvents << ' ' << s.InsMultiEvents << ' '
+            << s.Concordance() << ' ' << s.Qv() << '\n';
+    }
+    AsyncWriter writer{path};
+    writer.Write(out.str());
+}
+
+// Single pass over all records, routing rows and summary counts to the
+// record's partition. Outputs are opened once their first record arrives and
+// share one writer thread, so highly multiplexed runs stay cheap.
+void ProcessPartitioned(ReaderBase& reader, Partitioner& partitioner, const ReferenceSource& refs,
+                        const ColumnSet& columns, const ThreadBudget& budget,
+                        const std::string& outFile, const std::string& header,
+                        std::atomic<int64_t>& numUnresolved)
+{
+    static constexpr int32_t NOT_OPENED = -1;
+
+    MultiFileWriter writer;
+    std::vector<int32_t> files;
+    std::vector<MetricsSummary> summaries;
+    std::vector<std::string> names;
+
+    const RecordParser<PartitionedRow> parse = [&](const BAM::BamRecord& record) {
+        PartitionedRow row;
+        row.Metrics = ParseAlignment(record, refs, columns);
+        if (!row.Metrics.Resolved) {
+            ++numUnresolved;
+            return row;
+        }
+        row.Row = FormatMetrics(row.Metrics, columns);
+        try {
+            row.Partition = partitioner.Partition(record);
+        } catch (const std::runtime_error& e) {
+            RecordFailed(e.what());
+        }
+        return row;
+    };
+    const ResultConsumer<PartitionedRow> consume = [&](PartitionedRow&& row) {
+        if (!row.Metrics.Resolved) {
+            return;
+        }
+        const auto p = static_cast<size_t>(row.Partition);
+        if (p >= files.size()) {
+            files.resize(p + 1, NOT_OPENED);
+            summaries.resize(p + 1);
+            names.resize(p + 1);
+        }
+        if (files[p] == NOT_OPENED) {
+            names[p] = partitioner.Name(row.Partition);
+            files[p] = writer.Open(PartitionPath(outFile, names[p]));
+            writer.Write(files[p], header);
+        }
+        writer.Write(files[p], row.Row);
+        summaries[p].Add(row.Metrics);
+    };
+    ProcessRecords(reader, budget, parse, consume);
+
+    writer.Close();
+
+    std::vector<std::string> seenNames;
+    std::vector<MetricsSummary> seenSummaries;
+    for (size_t p = 0; p < files.size(); ++p) {
+        if (files[p] != NOT_OPENED) {
+            seenNames.push_back(names[p]);
+            seenSummaries.push_back(summaries[p]);
+        }
+    }
+    PBLOG_INFO << "Wrote " << seenNames.size() << " partitions";
+    WriteSummary(PartitionPath(outFile, Partitioner::SUMMARY_NAME), seenNames, seenSummaries);
+}
+
+int RunnerSubroutine(const CLI_v2::Results& options)
+{
+    Utility::Stopwatch globalTimer;
+    HarmonySettings settings{options};
+
+    const bool hasRef{boost::iends_with(settings.FileNames[1], ".fa") ||
+                      boost::iends_with(settings.FileNames[1], ".fasta") ||
+                      boost::iends_with(settings.FileNames[1], ".fa.gz") ||
+                      boost::iends_with(settings.FileNames[1], ".fasta.gz")};
+    const std::string alnFile{settings.FileNames[0]};
+
+    const bool streamInput{alnFile == SimpleBamParser::STREAM_PATH};
+    std::vector<std::string> bamFiles;
+    if (!streamInput) {
+        bamFiles = SimpleBamParser::GetBamFileNames(alnFile);
+    }
+    bool useCache{!settings.CacheDir.empty()};
+    if (useCache && SimpleBamParser::HasDataSetFilters(alnFile)) {
+        PBLOG_WARN << "Dataset filters are not supported by --cache-dir, caching is disabled.";
+        useCache = false;
+    }
+
+    // with the cache, BAM files are processed one at a time
+    const int32_t numBamFiles{streamInput || useCache ? 1 : static_cast<int32_t>(bamFiles.size())};
+    const ThreadBudget budget =
+        ThreadBudget::Compute(settings.NumThreads, numBamFiles, settings.Columns.HasExtended());
+    SetBamReaderDecompThreads(budget.DecompThreads);
+
+    LazyReferences lazyRefs{hasRef ? settings.FileNames[1] : std::string{}};
+    const ReferenceSource refs = [&lazyRefs]() -> const References& { return lazyRefs.Get(); };
+
+    const std::string outFile{hasRef ? settings.FileNames[2] : settings.FileNames[1]};
+    std::ostringstream header;
+    settings.Columns.WriteHeader(header);
+
+    // records whose M operations cannot be resolved are left out of all outputs
+    std::atomic<int64_t> numUnresolved{0};
+
+    if (settings.SplitBy != SplitMode::NONE) {
+        Partitioner partitioner{settings.SplitBy, SimpleBamParser::ExtractReadGroups(alnFile)};
+        std::unique_ptr<ReaderBase> alnReader = SimpleBamParser::BamQuery(alnFile, settings.Region);
+        ProcessPartitioned(*alnReader, partitioner, refs, settings.Columns, budget, outFile,
+                           header.str(), numUnresolved);
+    } else {
+        AsyncWriter outputFile{outFile};
+        outputFile.Write(header.str());
+        const RecordParser<std::string> parse = [&refs, &columns = settings.Columns,
+                                                 &numUnresolved](const BAM::BamRecord& record) {
+            const AlignmentMetrics metrics = ParseAlignment(record, refs, columns);
+            if (!metrics.Resolved) {
+                ++numUnresolved;
+                return std::string{};
+            }
+            return FormatMetrics(metrics, columns);
+        };
+        const ResultConsumer<std::string> output = [&outputFile](std::string&& row) {
+            outputFile.Write(row);
+        };
+
+        if (!useCache) {
+            std::unique_ptr<ReaderBase> alnReader =
+                SimpleBamParser::BamQuery(alnFile, settings.Region);
+            ProcessRecords(*alnReader, budget, parse, output);
+        } else {
+            std::string settingsKey{
+                "harmony " + LibraryInfo().Release + " " + LibraryInfo().GitSha1 +
+                "|columns=" + settings.Columns.ToString() + "|region=" + settings.Region};
+            if (hasRef) {
+                settingsKey += "|ref=" + ResultCache::FileIdentity(settings.FileNames[1]);
+            }
+            const ResultCache cache{settings.CacheDir, std::move(settingsKey)};
+            const RowSink replay = [&outputFile](std::string_view rows) { outputFile.Write(rows); };
+
+            for (const auto& bamFile : bamFiles) {
+                if (cache.Replay(bamFile, replay)) {
+                    PBLOG_INFO << "Using cached results for " << bamFile;
+                    continue;
+                }
+                PBLOG_INFO << "Processing " << bamFile;
+                ResultCache::Entry entry = cache.Create(bamFile);
+                std::unique_ptr<ReaderBase> reader =
+                    SimpleBamParser::BamQuery(bamFile, settings.Region);
+                const ResultConsumer<std::string> outputAndCache = [&outputFile,
+                                                                    &entry](std::string&& row) {
+                    outputFile.Write(row);
+                    entry.Write(row);
+                };
+                ProcessRecords(*reader, budget, parse, outputAndCache);
+                entry.Commit();
+            }
+        }
+        outputFile.Close();
+    }
+
+    if (numUnresolved > 0) {
+        PBLOG_WARN << "Skipped " << numUnresolved
+                   << " records with M operations but without a stored sequence, e.g. secondary "
+                      "alignments";
+    }
 
     globalTimer.Freeze();
     PBLOG_INFO << "Run Time : " << globalTimer.ElapsedTime();